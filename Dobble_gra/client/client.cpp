@@ -4,6 +4,12 @@
 #include <thread>
 #include <vector>
 #include <map>
+#include <set>
+#include <list>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
 #include <cstring>
 #include <arpa/inet.h>
 #include <unistd.h>
@@ -11,6 +17,10 @@
 
 
 #define PORT 8080
+#define CARD_SCALE 0.15f           // Skala, w jakiej karty są rysowane w oknie
+#define TEXTURE_CACHE_SIZE 8       // Maksymalna liczba tekstur kart trzymanych na GPU
+#define TEXTURE_PREFETCH 4         // Liczba jeszcze niewidzianych kart wczytywanych z wyprzedzeniem
+#define TEXTURE_LOADER_THREADS 2   // Liczba wątków dekodujących obrazy kart
 
 using json = nlohmann::json;
 
@@ -42,8 +52,22 @@ struct Card
     bool isPlayerCard;
 };
 
-// Mapa do przechowywania tekstur kart
+// Bufor tekstur kart (LRU) - tekstury w rozdzielczości wyświetlania
 std::map<int, sf::Texture> cardTextures;
+std::list<int> textureUsage; // Kolejność użycia tekstur, najnowsze na początku
+
+// Kolejka wątków wczytujących obrazy kart w tle
+std::mutex loaderMutex;
+std::condition_variable loaderCondition;
+std::deque<int> pendingCards;                        // Karty czekające na dekodowanie
+std::set<int> requestedCards;                        // Karty w kolejce, w dekodowaniu lub czekające na GPU
+std::set<int> missingCards;                          // Karty, których obrazu nie udało się wczytać
+std::vector<std::pair<int, sf::Image>> decodedCards; // Obrazy gotowe do wysłania na GPU
+std::vector<std::thread> loaderThreads;
+bool loadersRunning = false;
+
+std::set<int> shownCards; // Karty już wyświetlone w tej grze
+int deckSize = 0;         // Liczba obrazów kart w katalogu images
 
 // Globalne zmienne
 bool gameRunning = true;
@@ -54,22 +78,269 @@ int winnerScore = 0;
 int score = 0; 
 sf::Text winnerText;
 
-// Funkcja do załadowania tekstur kart
-void loadCardTextures()
+// Ścieżka do obrazu karty o danym ID
+std::string cardImagePath(int cardID)
+{
+    return "images/card_id" + std::to_string(cardID) + ".png";
+}
+
+// Zmniejszenie obrazu (uśrednianie bloków pikseli) do rozmiaru, w jakim jest rysowany
+sf::Image downscaleImage(const sf::Image &source, float scale)
 {
-    for (int i = 1; i <= 13; ++i)
+    sf::Vector2u sourceSize = source.getSize();
+    unsigned width = std::max(1u, static_cast<unsigned>(sourceSize.x * scale));
+    unsigned height = std::max(1u, static_cast<unsigned>(sourceSize.y * scale));
+    const sf::Uint8 *sourcePixels = source.getPixelsPtr();
+    std::vector<sf::Uint8> pixels(width * height * 4);
+
+    for (unsigned y = 0; y < height; ++y)
     {
-        sf::Texture texture;
-        std::string filename = "images/card_id" + std::to_string(i) + ".png";
-        if (texture.loadFromFile(filename))
+        unsigned y0 = y * sourceSize.y / height;
+        unsigned y1 = std::max(y0 + 1, (y + 1) * sourceSize.y / height);
+        for (unsigned x = 0; x < width; ++x)
         {
-            texture.setSmooth(true);
-            cardTextures[i] = texture;
+            unsigned x0 = x * sourceSize.x / width;
+            unsigned x1 = std::max(x0 + 1, (x + 1) * sourceSize.x / width);
+            unsigned sum[4] = {0, 0, 0, 0};
+            for (unsigned sy = y0; sy < y1; ++sy)
+            {
+                const sf::Uint8 *row = sourcePixels + (static_cast<size_t>(sy) * sourceSize.x + x0) * 4;
+                for (unsigned sx = x0; sx < x1; ++sx, row += 4)
+                {
+                    sum[0] += row[0];
+                    sum[1] += row[1];
+                    sum[2] += row[2];
+                    sum[3] += row[3];
+                }
+            }
+            unsigned count = (y1 - y0) * (x1 - x0);
+            sf::Uint8 *pixel = &pixels[(static_cast<size_t>(y) * width + x) * 4];
+            for (int c = 0; c < 4; ++c)
+            {
+                pixel[c] = static_cast<sf::Uint8>(sum[c] / count);
+            }
         }
-        else
+    }
+
+    sf::Image result;
+    result.create(width, height, pixels.data());
+    return result;
+}
+
+// Wątek dekodujący obrazy kart z kolejki pendingCards
+void textureLoaderWorker()
+{
+    while (true)
+    {
+        int cardID;
+        {
+            std::unique_lock<std::mutex> lock(loaderMutex);
+            loaderCondition.wait(lock, []
+                                 { return !pendingCards.empty() || !loadersRunning; });
+            if (!loadersRunning)
+            {
+                return;
+            }
+            cardID = pendingCards.front();
+            pendingCards.pop_front();
+        }
+
+        sf::Image image;
+        std::string filename = cardImagePath(cardID);
+        bool loaded = image.loadFromFile(filename);
+        if (!loaded)
         {
             std::cerr << "Nie udało się załadować obrazu " << filename << std::endl;
         }
+        sf::Image scaled = loaded ? downscaleImage(image, CARD_SCALE) : sf::Image();
+
+        std::lock_guard<std::mutex> lock(loaderMutex);
+        if (loaded)
+        {
+            decodedCards.emplace_back(cardID, scaled);
+        }
+        else
+        {
+            requestedCards.erase(cardID);
+            missingCards.insert(cardID);
+        }
+    }
+}
+
+// Zlecenie wczytania karty; urgent = karta potrzebna na ekranie teraz
+void requestCardTexture(int cardID, bool urgent)
+{
+    std::lock_guard<std::mutex> lock(loaderMutex);
+    if (missingCards.count(cardID))
+    {
+        return;
+    }
+    if (requestedCards.count(cardID))
+    {
+        // Karta czekająca w kolejce na prefetch staje się pilna
+        auto it = std::find(pendingCards.begin(), pendingCards.end(), cardID);
+        if (urgent && it != pendingCards.end())
+        {
+            pendingCards.erase(it);
+            pendingCards.push_front(cardID);
+        }
+        return;
+    }
+    requestedCards.insert(cardID);
+    if (urgent)
+    {
+        pendingCards.push_front(cardID);
+    }
+    else
+    {
+        pendingCards.push_back(cardID);
+    }
+    loaderCondition.notify_one();
+}
+
+// Liczba kolejnych plików images/card_idN.png (rozmiar talii)
+int countCardImages()
+{
+    int count = 0;
+    while (access(cardImagePath(count + 1).c_str(), R_OK) == 0)
+    {
+        ++count;
+    }
+    return count;
+}
+
+// Uruchomienie wątków wczytujących tekstury kart
+void startTextureLoaders()
+{
+    deckSize = countCardImages();
+    std::cout << "Znaleziono " << deckSize << " obrazów kart." << std::endl;
+
+    loadersRunning = true;
+    for (int i = 0; i < TEXTURE_LOADER_THREADS; ++i)
+    {
+        loaderThreads.emplace_back(textureLoaderWorker);
+    }
+}
+
+// Zatrzymanie wątków wczytujących tekstury kart
+void stopTextureLoaders()
+{
+    {
+        std::lock_guard<std::mutex> lock(loaderMutex);
+        loadersRunning = false;
+    }
+    loaderCondition.notify_all();
+    for (std::thread &thread : loaderThreads)
+    {
+        thread.join();
+    }
+    loaderThreads.clear();
+}
+
+// Przesunięcie karty na początek listy LRU
+void touchCardTexture(int cardID)
+{
+    textureUsage.remove(cardID);
+    textureUsage.push_front(cardID);
+}
+
+// Wysłanie zdekodowanych obrazów na GPU (tylko w wątku okna) i usunięcie najdawniej używanych tekstur.
+// Karty aktualnie na ekranie i karty wczytane z wyprzedzeniem, jeszcze niepokazane, nie są usuwane -
+// inaczej prefetchCardTextures zlecałby ich dekodowanie ponownie. Tych drugich jest najwyżej TEXTURE_PREFETCH.
+void uploadDecodedTextures(int playerCardID, int tableCardID)
+{
+    std::vector<std::pair<int, sf::Image>> ready;
+    {
+        std::lock_guard<std::mutex> lock(loaderMutex);
+        ready.swap(decodedCards);
+    }
+
+    for (const auto &[cardID, image] : ready)
+    {
+        sf::Texture &texture = cardTextures[cardID];
+        texture.loadFromImage(image);
+        texture.setSmooth(true);
+        touchCardTexture(cardID);
+    }
+
+    if (!ready.empty())
+    {
+        std::lock_guard<std::mutex> lock(loaderMutex);
+        for (const auto &entry : ready)
+        {
+            requestedCards.erase(entry.first);
+        }
+    }
+
+    for (auto it = textureUsage.end(); cardTextures.size() > TEXTURE_CACHE_SIZE && it != textureUsage.begin();)
+    {
+        --it;
+        if (*it == playerCardID || *it == tableCardID || !shownCards.count(*it))
+        {
+            continue;
+        }
+        cardTextures.erase(*it);
+        it = textureUsage.erase(it);
+    }
+}
+
+// Tekstura karty z bufora; gdy jej brak, zlecenie wczytania i nullptr
+const sf::Texture *getCardTexture(int cardID)
+{
+    if (cardID < 1 || cardID > deckSize)
+    {
+        return nullptr;
+    }
+
+    auto it = cardTextures.find(cardID);
+    if (it == cardTextures.end())
+    {
+        requestCardTexture(cardID, true);
+        return nullptr;
+    }
+    touchCardTexture(cardID);
+    return &it->second;
+}
+
+// Wczytanie z wyprzedzeniem kart, które mogą zostać wylosowane (jeszcze niewidzianych w tej grze)
+void prefetchCardTextures(int playerCardID, int tableCardID)
+{
+    for (int cardID : {playerCardID, tableCardID})
+    {
+        if (cardID >= 1 && cardID <= deckSize)
+        {
+            shownCards.insert(cardID);
+        }
+    }
+
+    int prefetched = 0;
+    {
+        std::lock_guard<std::mutex> lock(loaderMutex);
+        for (int cardID : requestedCards)
+        {
+            prefetched += shownCards.count(cardID) ? 0 : 1;
+        }
+    }
+    for (const auto &entry : cardTextures)
+    {
+        prefetched += shownCards.count(entry.first) ? 0 : 1;
+    }
+
+    for (int cardID = 1; cardID <= deckSize && prefetched < TEXTURE_PREFETCH; ++cardID)
+    {
+        if (shownCards.count(cardID) || cardTextures.count(cardID))
+        {
+            continue;
+        }
+        {
+            std::lock_guard<std::mutex> lock(loaderMutex);
+            if (requestedCards.count(cardID) || missingCards.count(cardID))
+            {
+                continue;
+            }
+        }
+        requestCardTexture(cardID, false);
+        ++prefetched;
     }
 }
 
@@ -202,8 +473,8 @@ int main(int argc, char *argv[])
         std::cerr << "Nie udało się załadować czcionki." << std::endl;
         return -1;
     }
-    // Załadowanie tekstur kart
-    loadCardTextures();
+    // Uruchomienie wczytywania tekstur kart w tle
+    startTextureLoaders();
 
     // Ekran wprowadzania imienia
     sf::Text enterNameText("Wprowadz swoja nazwe:", font, 24);
@@ -311,6 +582,12 @@ int main(int argc, char *argv[])
             }
         }
 
+        uploadDecodedTextures(playerCard.id, tableCard.id);
+        if (inLobby && !gameEnded)
+        {
+            prefetchCardTextures(playerCard.id, tableCard.id);
+        }
+
         window.clear(sf::Color::White);
 
         if (!inLobby)
@@ -321,18 +598,19 @@ int main(int argc, char *argv[])
         }
         else if (!gameEnded)
         {
-            if (cardTextures.find(playerCard.id) != cardTextures.end())
+            // Tekstury są już w rozdzielczości wyświetlania (CARD_SCALE)
+            const sf::Texture *playerCardTexture = getCardTexture(playerCard.id);
+            if (playerCardTexture != nullptr)
             {
-                sf::Sprite playerCardSprite(cardTextures[playerCard.id]);
-                playerCardSprite.setScale(0.15f, 0.15f);
+                sf::Sprite playerCardSprite(*playerCardTexture);
                 playerCardSprite.setPosition(450.f, 100.f);
                 window.draw(playerCardSprite);
             }
 
-            if (cardTextures.find(tableCard.id) != cardTextures.end())
+            const sf::Texture *tableCardTexture = getCardTexture(tableCard.id);
+            if (tableCardTexture != nullptr)
             {
-                sf::Sprite tableCardSprite(cardTextures[tableCard.id]);
-                tableCardSprite.setScale(0.15f, 0.15f);
+                sf::Sprite tableCardSprite(*tableCardTexture);
                 tableCardSprite.setPosition(50.f, 100.f);
                 window.draw(tableCardSprite);
             }
@@ -355,6 +633,7 @@ int main(int argc, char *argv[])
     }
 
     receiveThread.join();
+    stopTextureLoaders();
     close(clientSocket);
 
     return 0;
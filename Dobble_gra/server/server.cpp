@@ -3,17 +3,39 @@
 #include <vector>
 #include <string>
 #include <map>
+#include <unordered_map>
 #include <fstream>
 #include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
 #include <ctime>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <csignal>
 #include <unistd.h>
+#include <poll.h>
+#include <fcntl.h>
 #include <netinet/in.h>
 #include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/eventfd.h>
 #include <arpa/inet.h>
 #include "../json/include/nlohmann/json.hpp"
 #include <random>
 
 #define PORT 8080
+#define HANDOFF_NAME "dobble_server_handoff"  // Nazwa (przestrzeń abstrakcyjna, + UID) gniazda do gorącego restartu
+#define HANDOFF_FD_BATCH 200                   // Maksymalna liczba deskryptorów w jednej wiadomości SCM_RIGHTS
+#define HANDOFF_TIMEOUT_MS 5000                // Limit czasu na kroki przekazania serwera
+#define HANDOFF_MAGIC 0x44424c48u              // "DBLH" - początek strumienia przekazania
+#define HANDOFF_VERSION 1u                     // Wersja formatu przekazania; zmienić przy każdej zmianie formatu
+#define TRACE_BUFFER_LIMIT 100000              // Maksymalna liczba zdarzeń śledzenia w buforze jednego wątku
 
 using json = nlohmann::json;
 
@@ -43,8 +65,321 @@ std::map<int, Card> tableCards;               // Karta na stole dla każdego lob
 std::map<std::string, int> playerScores;      // Wyniki graczy
 std::map<int, Card> playerCards;              // Karty graczy
 std::map<int, std::vector<int>> lobbyClients; // Klienci w każdym lobby
+std::map<int, std::string> playerNames;       // Nazwa gracza dla każdego połączenia
+std::map<int, int> playerLobbies;             // Lobby, do którego należy połączenie
 std::vector<int> clientSockets;               // Lista wszystkich połączeń klientów
 bool gameStarted[3] = {false, false, false};  // Stan gry dla każdego lobby
+std::mutex clientsMutex;                      // Chroni clientSockets, playerNames, playerLobbies i pausedClients (nie playerCards)
+std::condition_variable clientsCondition;     // Zmiana liczby wstrzymanych wątków klientów lub koniec przekazania
+std::atomic<bool> handingOff{false};          // Trwa przekazanie serwera - wątki klientów nie czytają z połączeń
+int pausedClients = 0;                        // Liczba wątków klientów wstrzymanych na czas przekazania
+int handoffWakeFd = -1;                       // eventfd budzący wątki klientów przy przekazaniu
+std::vector<std::string> symbolNames;         // Nazwy symboli talii (indeks w commonSymbols)
+std::unordered_map<int, int> cardIndexById;   // Indeks karty w `cards` według ID
+std::vector<int16_t> commonSymbols;           // Tablica n×n: wspólny symbol każdej pary kart (indeks w symbolNames)
+
+// Serializacja karty do JSON (używana przy przekazaniu stanu)
+void to_json(json &j, const Card &card)
+{
+    j = json{{"id", card.id}, {"symbols", card.symbols}};
+}
+
+void from_json(const json &j, Card &card)
+{
+    card.id = j.at("id").get<int>();
+    card.symbols = j.at("symbols").get<std::vector<std::string>>();
+}
+
+// Zdarzenie śledzenia (zakres czasu w mikrosekundach)
+struct TraceEvent
+{
+    const char *name;
+    long long start;
+    long long duration;
+    int lobby;
+    int connection;
+};
+
+// Bufor zdarzeń śledzenia jednego wątku; mutex blokuje się tylko przy zrzucie
+struct TraceBuffer
+{
+    std::mutex mutex;
+    std::vector<TraceEvent> events;
+    size_t dropped = 0;
+    int threadID = 0;
+};
+
+std::atomic<bool> tracingEnabled{false};               // Śledzenie włączone flagą --sledzenie
+volatile sig_atomic_t traceDumpRequested = 0;          // Ustawiane przez SIGUSR1
+std::mutex traceBuffersMutex;                          // Chroni listę buforów
+std::vector<std::shared_ptr<TraceBuffer>> traceBuffers; // Bufory wszystkich wątków (także zakończonych)
+std::atomic<int> nextTraceThreadID{1};                 // Kolejne tid dla buforów; nie powtarzają się po zrzucie
+
+long long traceNow()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// Bufor bieżącego wątku, rejestrowany przy pierwszym użyciu
+TraceBuffer &threadTraceBuffer()
+{
+    thread_local std::shared_ptr<TraceBuffer> buffer = []
+    {
+        auto created = std::make_shared<TraceBuffer>();
+        std::lock_guard<std::mutex> lock(traceBuffersMutex);
+        created->threadID = nextTraceThreadID++;
+        traceBuffers.push_back(created);
+        return created;
+    }();
+    return *buffer;
+}
+
+// Zakres śledzenia: zapisuje czas od utworzenia do zniszczenia obiektu.
+// Przy wyłączonym śledzeniu kosztuje jeden odczyt flagi.
+struct TraceSpan
+{
+    const char *name;
+    int lobby;
+    int connection;
+    long long start;
+
+    TraceSpan(const char *name, int lobby = -1, int connection = -1)
+        : name(name), lobby(lobby), connection(connection),
+          start(tracingEnabled.load(std::memory_order_relaxed) ? traceNow() : -1)
+    {
+    }
+
+    ~TraceSpan()
+    {
+        if (start < 0)
+        {
+            return;
+        }
+        long long duration = traceNow() - start;
+        TraceBuffer &buffer = threadTraceBuffer();
+        std::lock_guard<std::mutex> lock(buffer.mutex);
+        if (buffer.events.size() < TRACE_BUFFER_LIMIT)
+        {
+            buffer.events.push_back({name, start, duration, lobby, connection});
+        }
+        else
+        {
+            buffer.dropped++;
+        }
+    }
+};
+
+// Zrzut zebranych zdarzeń do pliku w formacie Chrome trace-event (chrome://tracing, Perfetto).
+// Bufory są opróżniane, kolejny zrzut zawiera tylko nowe zdarzenia.
+void dumpTrace(const std::string &filename)
+{
+    json events = json::array();
+    size_t dropped = 0;
+    {
+        std::lock_guard<std::mutex> lock(traceBuffersMutex);
+        for (const auto &buffer : traceBuffers)
+        {
+            std::vector<TraceEvent> taken;
+            {
+                std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+                taken.swap(buffer->events);
+                dropped += buffer->dropped;
+                buffer->dropped = 0;
+            }
+            for (const TraceEvent &event : taken)
+            {
+                events.push_back({{"name", event.name},
+                                  {"cat", "server"},
+                                  {"ph", "X"},
+                                  {"ts", event.start},
+                                  {"dur", event.duration},
+                                  {"pid", getpid()},
+                                  {"tid", buffer->threadID},
+                                  {"args", {{"lobby", event.lobby}, {"connection", event.connection}}}});
+            }
+        }
+
+        // Bufory zakończonych wątków nie są już potrzebne
+        traceBuffers.erase(std::remove_if(traceBuffers.begin(), traceBuffers.end(),
+                                          [](const std::shared_ptr<TraceBuffer> &buffer)
+                                          { return buffer.use_count() == 1; }),
+                           traceBuffers.end());
+    }
+
+    std::ofstream file(filename);
+    if (!file.is_open())
+    {
+        std::cerr << "Nie można zapisać pliku śledzenia " << filename << std::endl;
+        return;
+    }
+    file << json{{"traceEvents", events}, {"displayTimeUnit", "ms"}}.dump();
+
+    std::cout << "Zapisano " << events.size() << " zdarzeń śledzenia do " << filename;
+    if (dropped > 0)
+    {
+        std::cout << " (pominięto " << dropped << " z powodu pełnych buforów)";
+    }
+    std::cout << std::endl;
+}
+
+void handleTraceSignal(int)
+{
+    traceDumpRequested = 1;
+}
+
+// Wypełnienie wierszy firstRow, firstRow + step, ... tablicy commonSymbols.
+// Dla karty i liczba wspólnych symboli z każdą inną kartą jest zliczana przez listy kart z każdym
+// jej symbolem (cardsWithSymbol), więc koszt wiersza zależy od liczby kart, a nie od liczby symboli talii.
+// Zwraca false i pierwszą błędną parę, gdy karty nie mają dokładnie jednego wspólnego symbolu.
+bool checkCardRows(const std::vector<std::vector<int>> &cardSymbols, const std::vector<std::vector<int>> &cardsWithSymbol,
+                   size_t firstRow, size_t step, const std::atomic<bool> &failed, size_t &badFirst, size_t &badSecond, int &badShared)
+{
+    size_t n = cards.size();
+    std::vector<int> shared(n, 0);
+    for (size_t i = firstRow; i < n && !failed.load(std::memory_order_relaxed); i += step)
+    {
+        int16_t *row = &commonSymbols[i * n];
+        for (int symbol : cardSymbols[i])
+        {
+            for (int j : cardsWithSymbol[symbol])
+            {
+                shared[j]++;
+                row[j] = symbol;
+            }
+        }
+
+        for (size_t j = 0; j < n; ++j)
+        {
+            if (j != i && shared[j] != 1)
+            {
+                badFirst = std::min(i, j);
+                badSecond = std::max(i, j);
+                badShared = shared[j];
+                return false;
+            }
+            shared[j] = 0;
+        }
+        row[i] = -1;
+    }
+    return true;
+}
+
+// Sprawdzenie reguły Dobble: każda para kart ma dokładnie jeden wspólny symbol.
+// Wiersze tablicy commonSymbols są liczone równolegle (checkCardRows), a wynik służy potem
+// do sprawdzania zgłoszeń jednym odczytem.
+bool validateDeck()
+{
+    auto startTime = std::chrono::steady_clock::now();
+    size_t n = cards.size();
+
+    symbolNames.clear();
+    std::unordered_map<std::string, int> symbolIndex;
+    for (const Card &card : cards)
+    {
+        for (const std::string &symbol : card.symbols)
+        {
+            if (symbolIndex.emplace(symbol, symbolNames.size()).second)
+            {
+                symbolNames.push_back(symbol);
+            }
+        }
+    }
+    if (symbolNames.size() > INT16_MAX)
+    {
+        std::cerr << "Talia ma za dużo symboli: " << symbolNames.size() << std::endl;
+        return false;
+    }
+
+    // Symbole każdej karty (indeksy) i karty z każdym symbolem
+    std::vector<std::vector<int>> cardSymbols(n);
+    std::vector<std::vector<int>> cardsWithSymbol(symbolNames.size());
+    cardIndexById.clear();
+    for (size_t i = 0; i < n; ++i)
+    {
+        const Card &card = cards[i];
+        if (!cardIndexById.emplace(card.id, i).second)
+        {
+            std::cerr << "Powtórzone ID karty: " << card.id << std::endl;
+            return false;
+        }
+
+        for (const std::string &symbol : card.symbols)
+        {
+            cardSymbols[i].push_back(symbolIndex[symbol]);
+        }
+        std::sort(cardSymbols[i].begin(), cardSymbols[i].end());
+        auto duplicate = std::adjacent_find(cardSymbols[i].begin(), cardSymbols[i].end());
+        if (duplicate != cardSymbols[i].end())
+        {
+            std::cerr << "Karta " << card.id << " zawiera symbol " << symbolNames[*duplicate] << " więcej niż raz." << std::endl;
+            return false;
+        }
+        for (int symbol : cardSymbols[i])
+        {
+            cardsWithSymbol[symbol].push_back(i);
+        }
+    }
+
+    commonSymbols.assign(n * n, -1);
+    std::atomic<bool> failed{false};
+    std::mutex errorMutex;
+    size_t badFirst = 0, badSecond = 0;
+    int badShared = 0;
+
+    // Wiersze rozdzielane naprzemiennie między wątki
+    size_t threadCount = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), n));
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threadCount; ++t)
+    {
+        workers.emplace_back([&, t]
+                             {
+            size_t first, second;
+            int shared;
+            if (!checkCardRows(cardSymbols, cardsWithSymbol, t, threadCount, failed, first, second, shared))
+            {
+                std::lock_guard<std::mutex> lock(errorMutex);
+                if (!failed.exchange(true))
+                {
+                    badFirst = first;
+                    badSecond = second;
+                    badShared = shared;
+                }
+            } });
+    }
+    for (std::thread &worker : workers)
+    {
+        worker.join();
+    }
+
+    if (failed)
+    {
+        std::cerr << "Niepoprawna talia: karty " << cards[badFirst].id << " i " << cards[badSecond].id
+                  << " mają " << badShared << " wspólnych symboli (powinien być dokładnie jeden)." << std::endl;
+        commonSymbols.clear();
+        return false;
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime);
+    std::cout << "Talia poprawna: " << n << " kart, " << symbolNames.size() << " symboli, "
+              << n * (n - 1) / 2 << " par sprawdzonych w " << elapsed.count() / 1000.0 << " ms ("
+              << threadCount << " wątków)." << std::endl;
+    return true;
+}
+
+// Wspólny symbol dwóch kart z tablicy commonSymbols (nullptr dla nieznanej karty lub tej samej karty)
+const std::string *commonSymbol(int firstCardID, int secondCardID)
+{
+    auto first = cardIndexById.find(firstCardID);
+    auto second = cardIndexById.find(secondCardID);
+    if (first == cardIndexById.end() || second == cardIndexById.end())
+    {
+        return nullptr;
+    }
+    int symbol = commonSymbols[static_cast<size_t>(first->second) * cards.size() + second->second];
+    return symbol < 0 ? nullptr : &symbolNames[symbol];
+}
 
 // Funkcja do wczytania kart z pliku JSON
 void loadCardsFromJSON(const std::string &filename)
@@ -78,6 +413,11 @@ void loadCardsFromJSON(const std::string &filename)
     }
 
     std::cout << "Wczytano " << cards.size() << " kart." << std::endl;
+
+    if (!validateDeck())
+    {
+        exit(EXIT_FAILURE);
+    }
 }
 
 // Tasowanie kart w talii danego lobby
@@ -129,9 +469,13 @@ void endGame(int lobbyID)
     snprintf(endMessage.playerName, sizeof(endMessage.playerName), "%s", winner.c_str());
     endMessage.tablecardid = -1; // Koniec gry
     // Wiadomość do klientów w lobby
-    for (int clientSocket : lobbyClients[lobbyID])
     {
-        send(clientSocket, &endMessage, sizeof(endMessage), 0);
+        TraceSpan broadcastSpan("broadcast", lobbyID);
+        for (int clientSocket : lobbyClients[lobbyID])
+        {
+            TraceSpan span("send", lobbyID, clientSocket);
+            send(clientSocket, &endMessage, sizeof(endMessage), 0);
+        }
     }
 
     std::cout << "Gra w lobby " << lobbyID << " zakończona! Wygral gracz: " << winner
@@ -147,9 +491,11 @@ void endGame(int lobbyID)
     initializeLobbyDeck(lobbyID);
 }
 
-// Losowanie karty z talii danego lobby
-Card drawCardFromLobby(int lobbyID)
+// Losowanie karty z talii danego lobby; connection to połączenie, dla którego losujemy (do śledzenia)
+Card drawCardFromLobby(int lobbyID, int connection)
 {
+    TraceSpan span("draw", lobbyID, connection);
+
     std::cout << "Rozpoczynam losowanie karty w lobby " << lobbyID
               << ". Liczba kart w talii: " << lobbyDecks[lobbyID].size() << std::endl;
 
@@ -168,8 +514,8 @@ Card drawCardFromLobby(int lobbyID)
     }
 }
 
-// Rozpoczęcie gry w lobby
-void startGame(int lobbyID)
+// Rozpoczęcie gry w lobby; connection to połączenie gracza, którego dołączenie uruchomiło grę
+void startGame(int lobbyID, int connection)
 {
     std::cout << "Rozpoczęcie gry w lobby " << lobbyID << std::endl;
 
@@ -180,7 +526,7 @@ void startGame(int lobbyID)
             return;
         }
         gameStarted[lobbyID] = true;
-        tableCards[lobbyID] = drawCardFromLobby(lobbyID); // Karta na stole
+        tableCards[lobbyID] = drawCardFromLobby(lobbyID, connection); // Karta na stole
 
         std::cout << "Karta stołowa w lobby " << lobbyID
                   << " ID: " << tableCards[lobbyID].id
@@ -198,23 +544,150 @@ void startGame(int lobbyID)
 
         GameMessage message;
         message.tablecardid = tableCards[lobbyID].id; // wiadomosc o karcie na stole
-        Card playerCard = drawCardFromLobby(lobbyID);
+        Card playerCard = drawCardFromLobby(lobbyID, clientSocket);
         playerCards[clientSocket] = playerCard; // zapisanie informacji o karcie gracza na serwerze
         message.cardID = playerCard.id;         // wiadomosc karta w rece
 
+        TraceSpan span("send", lobbyID, clientSocket);
         send(clientSocket, &message, sizeof(message), 0);
     }
 }
 
+// Usunięcie połączenia z rejestru klientów serwera
+void forgetClient(int clientSocket)
+{
+    {
+        std::lock_guard<std::mutex> lock(clientsMutex);
+        clientSockets.erase(std::remove(clientSockets.begin(), clientSockets.end(), clientSocket), clientSockets.end());
+        playerNames.erase(clientSocket);
+        playerLobbies.erase(clientSocket);
+    }
+    clientsCondition.notify_all();
+}
+
+// Czekanie na dane od klienta. Podczas przekazania serwera wątek zatrzymuje się tutaj,
+// żeby nie czytać z połączeń przejmowanych przez nowy proces.
+void waitForClientData(int clientSocket)
+{
+    struct pollfd fds[2] = {{clientSocket, POLLIN, 0}, {handoffWakeFd, POLLIN, 0}};
+    while (true)
+    {
+        if (handingOff)
+        {
+            std::unique_lock<std::mutex> lock(clientsMutex);
+            pausedClients++;
+            clientsCondition.notify_all();
+            clientsCondition.wait(lock, []
+                                  { return !handingOff; });
+            pausedClients--;
+            continue;
+        }
+
+        if (poll(fds, 2, -1) > 0 && fds[0].revents != 0 && !handingOff)
+        {
+            return;
+        }
+    }
+}
+
+// Pętla rozgrywki dla gracza przypisanego już do lobby
+void playClient(int clientSocket, std::string playerName, int chosenLobby)
+{
+    GameMessage message;
+
+    while (true)
+    {
+        // Czas oczekiwania na ruch gracza nie jest liczony do "recv"
+        waitForClientData(clientSocket);
+
+        int valread;
+        {
+            TraceSpan span("recv", chosenLobby, clientSocket);
+            valread = recv(clientSocket, &message, sizeof(message), 0);
+        }
+        if (valread <= 0)
+        {
+            std::cout << "Gracz " << playerName << " rozłączył się." << std::endl;
+            {
+                auto &clients = lobbyClients[chosenLobby];
+                clients.erase(std::remove(clients.begin(), clients.end(), clientSocket), clients.end());
+
+                std::cout << "Aktualna liczba klientów w lobby " << chosenLobby << ": "
+                          << clients.size() << std::endl;
+
+                // Usuń lobby, jeśli jest puste
+                if (clients.empty())
+                {
+                    lobbyClients.erase(chosenLobby);
+                    lobbyDecks.erase(chosenLobby);
+                    tableCards.erase(chosenLobby);
+                    gameStarted[chosenLobby] = false;
+                    std::cout << "Lobby " << chosenLobby << " zostało usunięte, ponieważ nie ma graczy."
+                              << std::endl;
+                }
+            }
+            break;
+        }
+
+        TraceSpan claimSpan("claim", chosenLobby, clientSocket);
+
+        std::string chosenSymbol;
+        {
+            TraceSpan span("decode", chosenLobby, clientSocket);
+            chosenSymbol = message.chosenSymbol;
+        }
+
+        bool match = false;
+        {
+            TraceSpan span("validate", chosenLobby, clientSocket);
+
+            // Talia jest sprawdzona przy wczytaniu, więc jedynym trafieniem jest wspólny symbol z tablicy
+            const std::string *common = commonSymbol(playerCards[clientSocket].id, tableCards[chosenLobby].id);
+            match = common != nullptr && *common == chosenSymbol;
+        }
+
+        if (match)
+        {
+            playerScores[playerName]++;
+
+            {
+                playerCards[clientSocket] = tableCards[chosenLobby];
+                tableCards[chosenLobby] = drawCardFromLobby(chosenLobby, clientSocket);
+            }
+
+            std::cout << "Gracz " << playerName << " zdobył punkt!" << std::endl;
+
+            TraceSpan broadcastSpan("broadcast", chosenLobby, clientSocket);
+            for (int socket : lobbyClients[chosenLobby])
+            {
+                GameMessage message;
+                {
+                    TraceSpan span("encode", chosenLobby, socket);
+                    message.tablecardid = tableCards[chosenLobby].id; // Ustawienie nowej karty na stole
+                    message.cardID = playerCards[socket].id;          // Karta przypisana do danego gracza
+                }
+
+                TraceSpan span("send", chosenLobby, socket);
+                send(socket, &message, sizeof(message), 0);
+            }
+        }
+    }
+
+    forgetClient(clientSocket);
+    close(clientSocket);
+}
+
 // Obsługa klienta
 void handleClient(int clientSocket)
 {
     GameMessage message;
 
+    waitForClientData(clientSocket);
     int valread = recv(clientSocket, &message, sizeof(message), 0);
     if (valread <= 0)
     {
         std::cerr << "Błąd połączenia z klientem. Nie odebrano danych." << std::endl;
+        forgetClient(clientSocket);
         close(clientSocket);
         return;
     }
@@ -230,6 +703,7 @@ void handleClient(int clientSocket)
         {
             std::cout << "Gra w lobby " << chosenLobby << " już trwa. Gracz "
                       << playerName << " nie może dołączyć." << std::endl;
+            forgetClient(clientSocket);
             close(clientSocket);
             return;
         }
@@ -244,6 +718,9 @@ void handleClient(int clientSocket)
 
         // Dodaj gracza do lobby
         lobbyClients[chosenLobby].push_back(clientSocket);
+        std::lock_guard<std::mutex> lock(clientsMutex);
+        playerNames[clientSocket] = playerName;
+        playerLobbies[clientSocket] = chosenLobby;
     }
 
     std::cout << "Gracz " << playerName << " dołączył do lobby " << chosenLobby
@@ -254,128 +731,652 @@ void handleClient(int clientSocket)
         if (!gameStarted[chosenLobby] && lobbyClients[chosenLobby].size() >= 2)
         {
             std::cout << "Startowanie gry w lobby " << chosenLobby << std::endl;
-            startGame(chosenLobby);
+            startGame(chosenLobby, clientSocket);
         }
     }
 
-    while (true)
+    playClient(clientSocket, playerName, chosenLobby);
+}
+
+// Wysłanie całego bufora (send może wysłać mniej bajtów niż żądano)
+bool sendAll(int socket, const void *data, size_t size)
+{
+    const char *bytes = static_cast<const char *>(data);
+    while (size > 0)
     {
-        valread = recv(clientSocket, &message, sizeof(message), 0);
-        if (valread <= 0)
+        ssize_t sent = send(socket, bytes, size, MSG_NOSIGNAL); // Zerwane gniazdo przekazania nie może zabić procesu
+        if (sent <= 0)
         {
-            std::cout << "Gracz " << playerName << " rozłączył się." << std::endl;
-            {
-                auto &clients = lobbyClients[chosenLobby];
-                clients.erase(std::remove(clients.begin(), clients.end(), clientSocket), clients.end());
+            return false;
+        }
+        bytes += sent;
+        size -= sent;
+    }
+    return true;
+}
 
-                std::cout << "Aktualna liczba klientów w lobby " << chosenLobby << ": "
-                          << clients.size() << std::endl;
+// Odebranie dokładnie size bajtów
+bool recvAll(int socket, void *data, size_t size)
+{
+    char *bytes = static_cast<char *>(data);
+    while (size > 0)
+    {
+        ssize_t received = recv(socket, bytes, size, MSG_WAITALL);
+        if (received <= 0)
+        {
+            return false;
+        }
+        bytes += received;
+        size -= received;
+    }
+    return true;
+}
 
-                // Usuń lobby, jeśli jest puste
-                if (clients.empty())
-                {
-                    lobbyClients.erase(chosenLobby);
-                    lobbyDecks.erase(chosenLobby);
-                    tableCards.erase(chosenLobby);
-                    gameStarted[chosenLobby] = false;
-                    std::cout << "Lobby " << chosenLobby << " zostało usunięte, ponieważ nie ma graczy."
-                              << std::endl;
-                }
-            }
-            break;
+// Wysłanie deskryptorów przez gniazdo uniksowe (SCM_RIGHTS), w paczkach po HANDOFF_FD_BATCH
+bool sendDescriptors(int unixSocket, const std::vector<int> &fds)
+{
+    uint32_t count = fds.size();
+    if (!sendAll(unixSocket, &count, sizeof(count)))
+    {
+        return false;
+    }
+
+    for (size_t offset = 0; offset < fds.size(); offset += HANDOFF_FD_BATCH)
+    {
+        size_t batch = std::min<size_t>(HANDOFF_FD_BATCH, fds.size() - offset);
+        char marker = 'F';
+        struct iovec iov = {&marker, sizeof(marker)};
+        std::vector<char> control(CMSG_SPACE(batch * sizeof(int)));
+
+        struct msghdr msg = {};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control.data();
+        msg.msg_controllen = control.size();
+
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(batch * sizeof(int));
+        memcpy(CMSG_DATA(cmsg), fds.data() + offset, batch * sizeof(int));
+
+        if (sendmsg(unixSocket, &msg, MSG_NOSIGNAL) != sizeof(marker))
+        {
+            return false;
         }
+    }
+    return true;
+}
 
-        std::string chosenSymbol = message.chosenSymbol;
+// Odebranie deskryptorów wysłanych przez sendDescriptors
+bool receiveDescriptors(int unixSocket, std::vector<int> &fds)
+{
+    uint32_t count = 0;
+    if (!recvAll(unixSocket, &count, sizeof(count)))
+    {
+        return false;
+    }
 
-        bool match = false;
+    while (fds.size() < count)
+    {
+        size_t batch = std::min<size_t>(HANDOFF_FD_BATCH, count - fds.size());
+        char marker;
+        struct iovec iov = {&marker, sizeof(marker)};
+        std::vector<char> control(CMSG_SPACE(batch * sizeof(int)));
+
+        struct msghdr msg = {};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control.data();
+        msg.msg_controllen = control.size();
+
+        if (recvmsg(unixSocket, &msg, 0) != sizeof(marker))
+        {
+            return false;
+        }
+
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        if (cmsg == nullptr || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+        {
+            return false;
+        }
+
+        size_t received = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        const int *data = reinterpret_cast<const int *>(CMSG_DATA(cmsg));
+        fds.insert(fds.end(), data, data + received);
+    }
+    return true;
+}
+
+// Zapis stanu lobby, kart i wyników do JSON (wątki klientów muszą być wstrzymane)
+json buildSnapshot()
+{
+    std::lock_guard<std::mutex> lock(clientsMutex);
+    json snapshot;
+    snapshot["cards"] = cards;
+    snapshot["symbolNames"] = symbolNames;
+    snapshot["sockets"] = clientSockets;
+    snapshot["playerScores"] = playerScores;
+    snapshot["gameStarted"] = std::vector<bool>(std::begin(gameStarted), std::end(gameStarted));
+
+    snapshot["lobbyDecks"] = json::array();
+    for (const auto &[lobbyID, deck] : lobbyDecks)
+    {
+        snapshot["lobbyDecks"].push_back({{"lobby", lobbyID}, {"cards", deck}});
+    }
+
+    snapshot["tableCards"] = json::array();
+    for (const auto &[lobbyID, card] : tableCards)
+    {
+        snapshot["tableCards"].push_back({{"lobby", lobbyID}, {"card", card}});
+    }
+
+    snapshot["lobbyClients"] = json::array();
+    for (const auto &[lobbyID, sockets] : lobbyClients)
+    {
+        snapshot["lobbyClients"].push_back({{"lobby", lobbyID}, {"sockets", sockets}});
+    }
+
+    snapshot["players"] = json::array();
+    for (const auto &[socket, name] : playerNames)
+    {
+        json player = {{"socket", socket}, {"name", name}, {"lobby", playerLobbies[socket]}};
+        if (playerCards.find(socket) != playerCards.end())
         {
-            Card &playerCard = playerCards[clientSocket];
-            Card &tableCard = tableCards[chosenLobby];
+            player["card"] = playerCards[socket];
+        }
+        snapshot["players"].push_back(player);
+    }
+
+    return snapshot;
+}
+
+// Odtworzenie stanu z JSON; socketMap tłumaczy numery deskryptorów starego procesu na nowe
+void restoreSnapshot(const json &snapshot, const std::map<int, int> &socketMap)
+{
+    cards = snapshot.at("cards").get<std::vector<Card>>();
+    symbolNames = snapshot.at("symbolNames").get<std::vector<std::string>>();
+    cardIndexById.clear();
+    for (size_t i = 0; i < cards.size(); ++i)
+    {
+        cardIndexById[cards[i].id] = i;
+    }
+    playerScores = snapshot.at("playerScores").get<std::map<std::string, int>>();
+
+    std::vector<bool> started = snapshot.at("gameStarted").get<std::vector<bool>>();
+    for (size_t i = 0; i < started.size() && i < std::size(gameStarted); ++i)
+    {
+        gameStarted[i] = started[i];
+    }
 
-            auto playerPos = std::find(playerCard.symbols.begin(), playerCard.symbols.end(), chosenSymbol);
-            auto tablePos = std::find(tableCard.symbols.begin(), tableCard.symbols.end(), chosenSymbol);
+    for (const auto &entry : snapshot.at("lobbyDecks"))
+    {
+        lobbyDecks[entry.at("lobby").get<int>()] = entry.at("cards").get<std::vector<Card>>();
+    }
 
-            if (playerPos != playerCard.symbols.end() && tablePos != tableCard.symbols.end())
+    for (const auto &entry : snapshot.at("tableCards"))
+    {
+        tableCards[entry.at("lobby").get<int>()] = entry.at("card").get<Card>();
+    }
+
+    for (const auto &entry : snapshot.at("lobbyClients"))
+    {
+        std::vector<int> &clients = lobbyClients[entry.at("lobby").get<int>()];
+        for (int oldSocket : entry.at("sockets").get<std::vector<int>>())
+        {
+            auto it = socketMap.find(oldSocket);
+            if (it != socketMap.end())
             {
-                match = true;
+                clients.push_back(it->second);
             }
         }
+    }
 
-        if (match)
+    for (const auto &player : snapshot.at("players"))
+    {
+        auto it = socketMap.find(player.at("socket").get<int>());
+        if (it == socketMap.end())
         {
-            playerScores[playerName]++;
+            continue;
+        }
+        playerNames[it->second] = player.at("name").get<std::string>();
+        playerLobbies[it->second] = player.at("lobby").get<int>();
+        if (player.contains("card"))
+        {
+            playerCards[it->second] = player.at("card").get<Card>();
+        }
+    }
 
-            {
-                playerCards[clientSocket] = tableCards[chosenLobby];
-                tableCards[chosenLobby] = drawCardFromLobby(chosenLobby);
-            }
+    for (const auto &[oldSocket, newSocket] : socketMap)
+    {
+        clientSockets.push_back(newSocket);
+    }
+}
 
-            std::cout << "Gracz " << playerName << " zdobył punkt!" << std::endl;
+// Adres gniazda do gorącego restartu w abstrakcyjnej przestrzeni nazw (bez pliku w /tmp).
+// UID w nazwie oddziela serwery różnych użytkowników.
+socklen_t handoffAddress(struct sockaddr_un &address)
+{
+    std::string name = std::string(HANDOFF_NAME) + "_" + std::to_string(getuid());
+    address = {};
+    address.sun_family = AF_UNIX;
+    memcpy(address.sun_path + 1, name.data(), std::min(name.size(), sizeof(address.sun_path) - 1));
+    return offsetof(struct sockaddr_un, sun_path) + 1 + std::min(name.size(), sizeof(address.sun_path) - 1);
+}
 
-            for (int socket : lobbyClients[chosenLobby])
-            {
-                GameMessage message;
-                message.tablecardid = tableCards[chosenLobby].id; // Ustawienie nowej karty na stole
-                message.cardID = playerCards[socket].id;          // Karta przypisana do danego gracza
+// Drugi koniec gniazda musi należeć do tego samego użytkownika; ustawienie limitów czasu
+bool prepareHandoffSocket(int unixSocket)
+{
+    struct ucred peer = {};
+    socklen_t peerSize = sizeof(peer);
+    if (getsockopt(unixSocket, SOL_SOCKET, SO_PEERCRED, &peer, &peerSize) < 0 || peer.uid != getuid())
+    {
+        std::cerr << "Odrzucono przekazanie serwera: proces innego użytkownika (UID " << peer.uid << ")." << std::endl;
+        return false;
+    }
 
-                send(socket, &message, sizeof(message), 0);
-            }
-        }
+    struct timeval timeout = {HANDOFF_TIMEOUT_MS / 1000, (HANDOFF_TIMEOUT_MS % 1000) * 1000};
+    setsockopt(unixSocket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(unixSocket, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    return true;
+}
+
+// Wstrzymanie wątków klientów przed zapisem stanu.
+// false, gdy któryś nie zatrzymał się w limicie czasu (np. wisi w send do wolnego klienta).
+bool pauseClientThreads()
+{
+    std::unique_lock<std::mutex> lock(clientsMutex);
+    handingOff = true;
+    uint64_t wake = 1;
+    if (write(handoffWakeFd, &wake, sizeof(wake)) != sizeof(wake))
+    {
+        perror("eventfd write failed");
     }
+    return clientsCondition.wait_for(lock, std::chrono::milliseconds(HANDOFF_TIMEOUT_MS), []
+                                     { return pausedClients == static_cast<int>(clientSockets.size()); });
+}
 
-    close(clientSocket);
+// Wznowienie wątków klientów po nieudanym przekazaniu
+void resumeClientThreads()
+{
+    uint64_t wake;
+    if (read(handoffWakeFd, &wake, sizeof(wake)) < 0 && errno != EAGAIN)
+    {
+        perror("eventfd read failed");
+    }
+    {
+        std::lock_guard<std::mutex> lock(clientsMutex);
+        handingOff = false;
+    }
+    clientsCondition.notify_all();
 }
 
-// Funkcja główna serwera
-int main()
+// Przekazanie gniazd nasłuchujących, połączeń i stanu nowemu procesowi.
+// Zwraca true, gdy nowy proces potwierdził przejęcie - stary proces musi wtedy od razu zakończyć pracę.
+bool handOffToNewServer(int handoffClient, int server_fd, int handoff_fd)
 {
-    loadCardsFromJSON("cards.json");
+    if (!prepareHandoffSocket(handoffClient))
+    {
+        return false;
+    }
 
-    int server_fd, new_socket;
-    struct sockaddr_in address;
-    int opt = 1;
-    int addrlen = sizeof(address);
+    if (!pauseClientThreads())
+    {
+        std::cerr << "Wątki klientów nie zatrzymały się na czas." << std::endl;
+        resumeClientThreads();
+        return false;
+    }
+
+    // Lista połączeń pochodzi z tego samego zapisu stanu, więc kolejność deskryptorów jej odpowiada
+    json snapshot = buildSnapshot();
+    std::vector<int> fds = {server_fd, handoff_fd};
+    for (int clientSocket : snapshot["sockets"])
+    {
+        fds.push_back(clientSocket);
+    }
+
+    std::string payload = snapshot.dump();
+    uint32_t payloadSize = payload.size();
+    uint64_t tableSize = commonSymbols.size();
+    uint32_t header[2] = {HANDOFF_MAGIC, HANDOFF_VERSION};
+    char ack = 0;
+
+    if (!sendAll(handoffClient, header, sizeof(header)) ||
+        !sendDescriptors(handoffClient, fds) ||
+        !sendAll(handoffClient, &payloadSize, sizeof(payloadSize)) ||
+        !sendAll(handoffClient, payload.data(), payload.size()) ||
+        !sendAll(handoffClient, &tableSize, sizeof(tableSize)) ||
+        !sendAll(handoffClient, commonSymbols.data(), tableSize * sizeof(int16_t)) ||
+        !recvAll(handoffClient, &ack, sizeof(ack)) || ack != 'K')
+    {
+        resumeClientThreads();
+        return false;
+    }
+
+    // Po dostarczeniu 'Z' połączenia obsługuje nowy proces. Bez 'Z' nowy proces kończy pracę,
+    // więc stary musi obsługiwać graczy dalej.
+    char done = 'Z';
+    if (!sendAll(handoffClient, &done, sizeof(done)))
+    {
+        resumeClientThreads();
+        return false;
+    }
+    return true;
+}
+
+// Przejęcie pracy od działającego serwera (gorący restart).
+// Zwraca gniazdo nasłuchujące (handoff_fd dostaje przejęte gniazdo do kolejnego restartu)
+// albo -1, gdy żaden serwer nie działa.
+int takeOverFromRunningServer(int &handoff_fd)
+{
+    int unixSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (unixSocket < 0)
+    {
+        perror("Unix socket creation failed");
+        return -1;
+    }
+
+    struct sockaddr_un address;
+    socklen_t addressSize = handoffAddress(address);
+
+    if (connect(unixSocket, (struct sockaddr *)&address, addressSize) < 0)
+    {
+        std::cout << "Brak działającego serwera do przejęcia. Zwykły start." << std::endl;
+        close(unixSocket);
+        return -1;
+    }
+
+    if (!prepareHandoffSocket(unixSocket))
+    {
+        exit(EXIT_FAILURE);
+    }
+
+    uint32_t header[2] = {0, 0};
+    if (!recvAll(unixSocket, header, sizeof(header)) || header[0] != HANDOFF_MAGIC || header[1] != HANDOFF_VERSION)
+    {
+        std::cerr << "Niezgodny format przekazania (wersja " << header[1] << ", oczekiwano "
+                  << HANDOFF_VERSION << ")." << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    std::vector<int> fds;
+    uint32_t payloadSize = 0;
+    std::string payload;
+    if (!receiveDescriptors(unixSocket, fds) || fds.size() < 2 ||
+        !recvAll(unixSocket, &payloadSize, sizeof(payloadSize)))
+    {
+        std::cerr << "Nie udało się odebrać deskryptorów od starego serwera." << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    payload.resize(payloadSize);
+    if (!recvAll(unixSocket, payload.data(), payload.size()))
+    {
+        std::cerr << "Nie udało się odebrać stanu od starego serwera." << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    json snapshot = json::parse(payload, nullptr, false);
+    if (snapshot.is_discarded())
+    {
+        std::cerr << "Niepoprawny stan otrzymany od starego serwera." << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    // Tablica wspólnych symboli jest przesyłana binarnie, żeby nie sprawdzać talii ponownie
+    uint64_t tableSize = 0;
+    if (!recvAll(unixSocket, &tableSize, sizeof(tableSize)))
+    {
+        std::cerr << "Nie udało się odebrać tablicy wspólnych symboli." << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    uint64_t cardCount = snapshot.at("cards").size();
+    if (tableSize != cardCount * cardCount)
+    {
+        std::cerr << "Rozmiar tablicy wspólnych symboli (" << tableSize << ") nie pasuje do "
+                  << cardCount << " kart." << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    commonSymbols.resize(tableSize);
+    if (!recvAll(unixSocket, commonSymbols.data(), tableSize * sizeof(int16_t)))
+    {
+        std::cerr << "Nie udało się odebrać tablicy wspólnych symboli." << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    int symbolCount = snapshot.at("symbolNames").size();
+    if (std::any_of(commonSymbols.begin(), commonSymbols.end(), [symbolCount](int16_t symbol)
+                    { return symbol < -1 || symbol >= symbolCount; }))
+    {
+        std::cerr << "Tablica wspólnych symboli zawiera niepoprawny indeks symbolu." << std::endl;
+        exit(EXIT_FAILURE);
+    }
 
-    if ((server_fd = socket(AF_INET, SOCK_STREAM, 0)) == 0)
+    // fds[0] to gniazdo nasłuchujące, fds[1] gniazdo przekazania, kolejne odpowiadają liście "sockets"
+    std::vector<int> oldSockets = snapshot.at("sockets").get<std::vector<int>>();
+    if (oldSockets.size() + 2 != fds.size())
     {
-        perror("Socket creation failed");
+        std::cerr << "Liczba odebranych połączeń nie zgadza się ze stanem." << std::endl;
         exit(EXIT_FAILURE);
     }
+    std::map<int, int> socketMap;
+    for (size_t i = 0; i < oldSockets.size(); ++i)
+    {
+        socketMap[oldSockets[i]] = fds[i + 2];
+    }
+    restoreSnapshot(snapshot, socketMap);
+
+    // Potwierdzenie i odpowiedź starego procesu: po 'Z' stary proces już nie obsługuje połączeń.
+    // Bez 'Z' stary proces wznowił pracę, więc nowy nie może jej przejąć.
+    char ack = 'K', done = 0;
+    if (!sendAll(unixSocket, &ack, sizeof(ack)) || !recvAll(unixSocket, &done, sizeof(done)) || done != 'Z')
+    {
+        std::cerr << "Stary serwer nie potwierdził przekazania." << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    close(unixSocket);
+
+    struct ResumedClient
+    {
+        int socket;
+        bool joined;
+        std::string name;
+        int lobby;
+    };
+    std::vector<ResumedClient> resumed;
+    for (int clientSocket : clientSockets)
+    {
+        bool joined = playerNames.find(clientSocket) != playerNames.end();
+        resumed.push_back({clientSocket, joined, joined ? playerNames[clientSocket] : "", joined ? playerLobbies[clientSocket] : -1});
+    }
+
+    for (const ResumedClient &client : resumed)
+    {
+        if (client.joined)
+        {
+            std::thread(playClient, client.socket, client.name, client.lobby).detach();
+        }
+        else
+        {
+            // Połączenie, które nie zdążyło wysłać zgłoszenia do lobby
+            std::thread(handleClient, client.socket).detach();
+        }
+    }
+
+    std::cout << "Przejęto serwer: " << resumed.size() << " połączeń, "
+              << lobbyClients.size() << " lobby." << std::endl;
+    handoff_fd = fds[1];
+    return fds[0];
+}
 
-    if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR | SO_REUSEPORT, &opt, sizeof(opt)))
+// Gniazdo uniksowe, na którym nowy proces może zgłosić przejęcie serwera
+int createHandoffListener()
+{
+    int handoff_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (handoff_fd < 0)
     {
-        perror("setsockopt failed");
+        perror("Unix socket creation failed");
         exit(EXIT_FAILURE);
     }
 
-    address.sin_family = AF_INET;
-    address.sin_addr.s_addr = INADDR_ANY;
-    address.sin_port = htons(PORT);
+    struct sockaddr_un address;
+    socklen_t addressSize = handoffAddress(address);
 
-    if (bind(server_fd, (struct sockaddr *)&address, sizeof(address)) < 0)
+    if (bind(handoff_fd, (struct sockaddr *)&address, addressSize) < 0 || listen(handoff_fd, 1) < 0)
     {
-        perror("Bind failed");
+        perror("Handoff socket setup failed (czy serwer już działa?)");
         exit(EXIT_FAILURE);
     }
+    return handoff_fd;
+}
+
+// Funkcja główna serwera
+int main(int argc, char *argv[])
+{
+    int server_fd = -1, new_socket;
+    struct sockaddr_in address;
+    int opt = 1;
+    int addrlen = sizeof(address);
+
+    // SIGUSR1 odbiera tylko wątek główny (w ppoll); wątki klientów dziedziczą zablokowany sygnał
+    sigset_t traceSignal, pollMask;
+    sigemptyset(&traceSignal);
+    sigaddset(&traceSignal, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &traceSignal, &pollMask);
+    sigdelset(&pollMask, SIGUSR1);
+    signal(SIGUSR1, handleTraceSignal);
+
+    // ./server --przejmij : gorący restart, przejęcie połączeń od działającego procesu
+    // ./server --sledzenie : zbieranie zdarzeń śledzenia, zrzut do trace_N.json po kill -USR1
+    bool takeover = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--przejmij")
+        {
+            takeover = true;
+        }
+        else if (arg == "--sledzenie")
+        {
+            tracingEnabled = true;
+        }
+    }
 
-    if (listen(server_fd, 10) < 0)
+    handoffWakeFd = eventfd(0, EFD_NONBLOCK);
+    if (handoffWakeFd < 0)
     {
-        perror("Listen failed");
+        perror("eventfd failed");
         exit(EXIT_FAILURE);
     }
 
+    int handoff_fd = -1;
+    if (takeover)
+    {
+        server_fd = takeOverFromRunningServer(handoff_fd);
+    }
+
+    if (server_fd < 0)
+    {
+        loadCardsFromJSON("cards.json");
+
+        if ((server_fd = socket(AF_INET, SOCK_STREAM, 0)) == 0)
+        {
+            perror("Socket creation failed");
+            exit(EXIT_FAILURE);
+        }
+
+        if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR | SO_REUSEPORT, &opt, sizeof(opt)))
+        {
+            perror("setsockopt failed");
+            exit(EXIT_FAILURE);
+        }
+
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = INADDR_ANY;
+        address.sin_port = htons(PORT);
+
+        if (bind(server_fd, (struct sockaddr *)&address, sizeof(address)) < 0)
+        {
+            perror("Bind failed");
+            exit(EXIT_FAILURE);
+        }
+
+        if (listen(server_fd, 10) < 0)
+        {
+            perror("Listen failed");
+            exit(EXIT_FAILURE);
+        }
+
+        // Nieblokujące accept: przy przekazaniu gniazdo jest chwilowo współdzielone przez dwa procesy
+        fcntl(server_fd, F_SETFL, fcntl(server_fd, F_GETFL) | O_NONBLOCK);
+
+        std::fill(std::begin(gameStarted), std::end(gameStarted), false);
+
+        handoff_fd = createHandoffListener();
+    }
+
     std::cout << "Serwer uruchomiony. Oczekiwanie na połączenia..." << std::endl;
 
-    std::fill(std::begin(gameStarted), std::end(gameStarted), false);
+    struct pollfd pollFds[2] = {{server_fd, POLLIN, 0}, {handoff_fd, POLLIN, 0}};
+    int traceDumpCount = 0;
 
     while (true)
     {
+        int ready = ppoll(pollFds, 2, nullptr, &pollMask);
+
+        if (traceDumpRequested)
+        {
+            traceDumpRequested = 0;
+            if (tracingEnabled)
+            {
+                dumpTrace("trace_" + std::to_string(++traceDumpCount) + ".json");
+            }
+            else
+            {
+                std::cerr << "Śledzenie wyłączone (uruchom serwer z --sledzenie). Brak zrzutu." << std::endl;
+            }
+        }
+
+        if (ready < 0)
+        {
+            if (errno != EINTR)
+            {
+                perror("Poll failed");
+            }
+            continue;
+        }
+
+        if (pollFds[1].revents & POLLIN)
+        {
+            int handoffClient = accept(handoff_fd, nullptr, nullptr);
+            if (handoffClient >= 0)
+            {
+                if (handOffToNewServer(handoffClient, server_fd, handoff_fd))
+                {
+                    std::cout << "Serwer przekazany nowemu procesowi. Zamykanie." << std::endl;
+                    _exit(EXIT_SUCCESS);
+                }
+                std::cerr << "Przekazanie serwera nieudane. Kontynuacja pracy." << std::endl;
+                close(handoffClient);
+            }
+        }
+
+        if (!(pollFds[0].revents & POLLIN))
+        {
+            continue;
+        }
+
         if ((new_socket = accept(server_fd, (struct sockaddr *)&address, (socklen_t *)&addrlen)) < 0)
         {
-            perror("Accept failed");
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+                perror("Accept failed");
+            }
             continue;
         }
 
+        {
+            std::lock_guard<std::mutex> lock(clientsMutex);
+            clientSockets.push_back(new_socket);
+        }
         std::thread clientThread(handleClient, new_socket);
         clientThread.detach();
     }